@@ -0,0 +1,431 @@
+#include "api_payload.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace api::v1;
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+std::string toLower(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+bool isMsgPackMediaType(const std::string& type) {
+    return type == "application/msgpack" ||
+           type == "application/x-msgpack" ||
+           type == "application/vnd.msgpack";
+}
+
+// q для одного формата: точное совпадение важнее wildcard
+struct Preference {
+    double exact = -1;
+    double wildcard = -1;
+
+    double effective() const { return exact >= 0 ? exact : std::max(wildcard, 0.0); }
+};
+
+} // namespace
+
+bool api::v1::isMsgPackContentType(std::string_view contentType) {
+    auto semicolon = contentType.find(';');
+    return isMsgPackMediaType(toLower(trim(contentType.substr(0, semicolon))));
+}
+
+PayloadFormat api::v1::negotiatePayloadFormat(std::string_view accept,
+                                              std::string_view contentType) {
+    bool requestIsMsgPack = isMsgPackContentType(contentType);
+    if (trim(accept).empty()) {
+        return requestIsMsgPack ? PayloadFormat::MsgPack : PayloadFormat::Json;
+    }
+
+    Preference json;
+    Preference msgpack;
+    while (!accept.empty()) {
+        auto comma = accept.find(',');
+        auto range = accept.substr(0, comma);
+        accept = comma == std::string_view::npos ? std::string_view() : accept.substr(comma + 1);
+
+        auto semicolon = range.find(';');
+        std::string type = toLower(trim(range.substr(0, semicolon)));
+        double q = 1.0;
+        while (semicolon != std::string_view::npos) {
+            range = range.substr(semicolon + 1);
+            semicolon = range.find(';');
+            auto param = trim(range.substr(0, semicolon));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+            }
+        }
+
+        if (type == "application/json") {
+            json.exact = std::max(json.exact, q);
+        } else if (isMsgPackMediaType(type)) {
+            msgpack.exact = std::max(msgpack.exact, q);
+        } else if (type == "*/*" || type == "application/*") {
+            json.wildcard = std::max(json.wildcard, q);
+            msgpack.wildcard = std::max(msgpack.wildcard, q);
+        }
+    }
+
+    double jsonQ = json.effective();
+    double msgpackQ = msgpack.effective();
+    if (msgpackQ > jsonQ || (msgpackQ > 0 && msgpackQ == jsonQ && requestIsMsgPack)) {
+        return PayloadFormat::MsgPack;
+    }
+    return PayloadFormat::Json;
+}
+
+// ---- JsonValueWriter ----
+
+Json::Value& JsonValueWriter::place(Json::Value v) {
+    if (stack_.empty()) {
+        root_ = std::move(v);
+        return root_;
+    }
+    Json::Value& parent = *stack_.back();
+    if (parent.isArray()) {
+        return parent.append(std::move(v));
+    }
+    return parent[pendingKey_] = std::move(v);
+}
+
+void JsonValueWriter::beginObject() {
+    stack_.push_back(&place(Json::Value(Json::objectValue)));
+}
+
+void JsonValueWriter::endObject() {
+    stack_.pop_back();
+}
+
+void JsonValueWriter::beginArray() {
+    stack_.push_back(&place(Json::Value(Json::arrayValue)));
+}
+
+void JsonValueWriter::endArray() {
+    stack_.pop_back();
+}
+
+void JsonValueWriter::key(std::string_view name) {
+    pendingKey_.assign(name.data(), name.size());
+}
+
+void JsonValueWriter::writeNull() {
+    place(Json::Value());
+}
+
+void JsonValueWriter::writeBool(bool v) {
+    place(Json::Value(v));
+}
+
+void JsonValueWriter::writeInt(int64_t v) {
+    place(Json::Value(static_cast<Json::Int64>(v)));
+}
+
+void JsonValueWriter::writeString(std::string_view v) {
+    place(Json::Value(v.data(), v.data() + v.size()));
+}
+
+// ---- MsgPackWriter ----
+
+void MsgPackWriter::putBigEndian(uint64_t v, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        buffer_.push_back(static_cast<char>((v >> shift) & 0xff));
+    }
+}
+
+void MsgPackWriter::countValue() {
+    // В map считаем пары по ключам, в array — элементы
+    if (!stack_.empty() && !stack_.back().isMap) {
+        ++stack_.back().count;
+    }
+}
+
+void MsgPackWriter::beginContainer(bool isMap) {
+    countValue();
+    stack_.push_back({buffer_.size(), 0, isMap});
+    // Место под fixmap/fixarray; если элементов больше 15, заголовок расширим
+    buffer_.push_back('\0');
+}
+
+void MsgPackWriter::endContainer() {
+    Container c = stack_.back();
+    stack_.pop_back();
+    if (c.count <= 15) {
+        buffer_[c.offset] = static_cast<char>((c.isMap ? 0x80 : 0x90) | c.count);
+        return;
+    }
+    std::string header;
+    if (c.count <= 0xffff) {
+        header.push_back(static_cast<char>(c.isMap ? 0xde : 0xdc));
+        header.push_back(static_cast<char>(c.count >> 8));
+        header.push_back(static_cast<char>(c.count & 0xff));
+    } else {
+        header.push_back(static_cast<char>(c.isMap ? 0xdf : 0xdd));
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            header.push_back(static_cast<char>((c.count >> shift) & 0xff));
+        }
+    }
+    buffer_.replace(c.offset, 1, header);
+}
+
+void MsgPackWriter::beginObject() {
+    beginContainer(true);
+}
+
+void MsgPackWriter::endObject() {
+    endContainer();
+}
+
+void MsgPackWriter::beginArray() {
+    beginContainer(false);
+}
+
+void MsgPackWriter::endArray() {
+    endContainer();
+}
+
+void MsgPackWriter::key(std::string_view name) {
+    ++stack_.back().count;
+    writeString(name);
+}
+
+void MsgPackWriter::writeNull() {
+    countValue();
+    buffer_.push_back(static_cast<char>(0xc0));
+}
+
+void MsgPackWriter::writeBool(bool v) {
+    countValue();
+    buffer_.push_back(static_cast<char>(v ? 0xc3 : 0xc2));
+}
+
+void MsgPackWriter::writeInt(int64_t v) {
+    countValue();
+    if (v >= 0) {
+        auto u = static_cast<uint64_t>(v);
+        if (u <= 0x7f) {
+            buffer_.push_back(static_cast<char>(u));
+        } else if (u <= 0xff) {
+            buffer_.push_back(static_cast<char>(0xcc));
+            putBigEndian(u, 1);
+        } else if (u <= 0xffff) {
+            buffer_.push_back(static_cast<char>(0xcd));
+            putBigEndian(u, 2);
+        } else if (u <= 0xffffffffULL) {
+            buffer_.push_back(static_cast<char>(0xce));
+            putBigEndian(u, 4);
+        } else {
+            buffer_.push_back(static_cast<char>(0xcf));
+            putBigEndian(u, 8);
+        }
+    } else if (v >= -32) {
+        buffer_.push_back(static_cast<char>(v));
+    } else if (v >= INT8_MIN) {
+        buffer_.push_back(static_cast<char>(0xd0));
+        putBigEndian(static_cast<uint64_t>(v), 1);
+    } else if (v >= INT16_MIN) {
+        buffer_.push_back(static_cast<char>(0xd1));
+        putBigEndian(static_cast<uint64_t>(v), 2);
+    } else if (v >= INT32_MIN) {
+        buffer_.push_back(static_cast<char>(0xd2));
+        putBigEndian(static_cast<uint64_t>(v), 4);
+    } else {
+        buffer_.push_back(static_cast<char>(0xd3));
+        putBigEndian(static_cast<uint64_t>(v), 8);
+    }
+}
+
+void MsgPackWriter::writeString(std::string_view v) {
+    countValue();
+    size_t n = v.size();
+    if (n <= 31) {
+        buffer_.push_back(static_cast<char>(0xa0 | n));
+    } else if (n <= 0xff) {
+        buffer_.push_back(static_cast<char>(0xd9));
+        putBigEndian(n, 1);
+    } else if (n <= 0xffff) {
+        buffer_.push_back(static_cast<char>(0xda));
+        putBigEndian(n, 2);
+    } else {
+        buffer_.push_back(static_cast<char>(0xdb));
+        putBigEndian(n, 4);
+    }
+    buffer_.append(v.data(), n);
+}
+
+// ---- Декодирование ----
+
+namespace {
+
+class MsgPackReader {
+public:
+    explicit MsgPackReader(std::string_view data) : data_(data) {}
+
+    bool atEnd() const { return pos_ == data_.size(); }
+
+    bool readByte(uint8_t& b) {
+        if (pos_ >= data_.size()) {
+            return false;
+        }
+        b = static_cast<uint8_t>(data_[pos_++]);
+        return true;
+    }
+
+    bool readBigEndian(int bytes, uint64_t& v) {
+        if (data_.size() - pos_ < static_cast<size_t>(bytes)) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < bytes; ++i) {
+            v = (v << 8) | static_cast<uint8_t>(data_[pos_++]);
+        }
+        return true;
+    }
+
+    bool readBytes(uint64_t n, std::string& out) {
+        if (data_.size() - pos_ < n) {
+            return false;
+        }
+        out.assign(data_.data() + pos_, n);
+        pos_ += n;
+        return true;
+    }
+
+    bool readMapSize(uint64_t& n) {
+        uint8_t b;
+        if (!readByte(b)) {
+            return false;
+        }
+        if ((b & 0xf0) == 0x80) {
+            n = b & 0x0f;
+            return true;
+        }
+        if (b == 0xde) {
+            return readBigEndian(2, n);
+        }
+        if (b == 0xdf) {
+            return readBigEndian(4, n);
+        }
+        return false;
+    }
+
+    // Скаляр в строку по правилам Json::Value::asString()
+    bool readScalarAsString(std::string& out) {
+        uint8_t b;
+        if (!readByte(b)) {
+            return false;
+        }
+        uint64_t u;
+        if (b <= 0x7f) {
+            out = std::to_string(b);
+            return true;
+        }
+        if (b >= 0xe0) {
+            out = std::to_string(static_cast<int8_t>(b));
+            return true;
+        }
+        if ((b & 0xe0) == 0xa0) {
+            return readBytes(b & 0x1f, out);
+        }
+        switch (b) {
+        case 0xc0:
+            out.clear();
+            return true;
+        case 0xc2:
+            out = "false";
+            return true;
+        case 0xc3:
+            out = "true";
+            return true;
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (!readBigEndian(1 << (b - 0xcc), u)) {
+                return false;
+            }
+            out = std::to_string(u);
+            return true;
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3: {
+            int bytes = 1 << (b - 0xd0);
+            if (!readBigEndian(bytes, u)) {
+                return false;
+            }
+            // Расширяем знак до 64 бит
+            int shift = 64 - bytes * 8;
+            int64_t v = shift ? static_cast<int64_t>(u << shift) >> shift : static_cast<int64_t>(u);
+            out = std::to_string(v);
+            return true;
+        }
+        case 0xca: {
+            if (!readBigEndian(4, u)) {
+                return false;
+            }
+            auto bits = static_cast<uint32_t>(u);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            out = Json::valueToString(static_cast<double>(f));
+            return true;
+        }
+        case 0xcb: {
+            if (!readBigEndian(8, u)) {
+                return false;
+            }
+            double d;
+            std::memcpy(&d, &u, sizeof(d));
+            out = Json::valueToString(d);
+            return true;
+        }
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            return readBigEndian(1 << (b - 0xd9), u) && readBytes(u, out);
+        default:
+            // Вложенные map/array, bin и ext в полях запроса не поддерживаем
+            return false;
+        }
+    }
+
+private:
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+bool api::v1::decodeMsgPackFields(std::string_view data,
+                                  std::unordered_map<std::string, std::string>& fields) {
+    MsgPackReader reader(data);
+    uint64_t size;
+    if (!reader.readMapSize(size)) {
+        return false;
+    }
+    fields.clear();
+    for (uint64_t i = 0; i < size; ++i) {
+        std::string key;
+        std::string value;
+        if (!reader.readScalarAsString(key) || !reader.readScalarAsString(value)) {
+            return false;
+        }
+        fields[std::move(key)] = std::move(value);
+    }
+    return reader.atEnd();
+}
@@ -0,0 +1,128 @@
+// api_payload.h
+
+#pragma once
+
+#include <json/json.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace api::v1 {
+
+// Формат тела запроса/ответа для /api/v1
+enum class PayloadFormat {
+    Json,
+    MsgPack
+};
+
+constexpr const char* kMsgPackContentType = "application/msgpack";
+
+bool isMsgPackContentType(std::string_view contentType);
+
+// Выбирает формат ответа по Accept (с учётом q), а без Accept —
+// по Content-Type запроса. По умолчанию JSON.
+PayloadFormat negotiatePayloadFormat(std::string_view accept, std::string_view contentType);
+
+// Потоковая запись payload: обработчики описывают данные один раз,
+// а конкретный writer кодирует их в свой формат.
+class PayloadWriter {
+public:
+    virtual ~PayloadWriter() = default;
+
+    virtual void beginObject() = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray() = 0;
+    virtual void endArray() = 0;
+    virtual void key(std::string_view name) = 0;
+
+    void value(std::nullptr_t) { writeNull(); }
+    void value(bool v) { writeBool(v); }
+    void value(int v) { writeInt(v); }
+    void value(int64_t v) { writeInt(v); }
+    void value(const char* v) { writeString(v); }
+    void value(std::string_view v) { writeString(v); }
+    void value(const std::string& v) { writeString(v); }
+
+    template <typename T>
+    void field(std::string_view name, T&& v) {
+        key(name);
+        value(std::forward<T>(v));
+    }
+
+protected:
+    virtual void writeNull() = 0;
+    virtual void writeBool(bool v) = 0;
+    virtual void writeInt(int64_t v) = 0;
+    virtual void writeString(std::string_view v) = 0;
+};
+
+// Собирает Json::Value — для JSON-ответов через newHttpJsonResponse
+class JsonValueWriter : public PayloadWriter {
+public:
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(std::string_view name) override;
+
+    Json::Value& root() { return root_; }
+
+protected:
+    void writeNull() override;
+    void writeBool(bool v) override;
+    void writeInt(int64_t v) override;
+    void writeString(std::string_view v) override;
+
+private:
+    Json::Value& place(Json::Value v);
+
+    Json::Value root_;
+    std::vector<Json::Value*> stack_;
+    std::string pendingKey_;
+};
+
+// Пишет MessagePack прямо в буфер. Размер map/array заранее не нужен:
+// заголовок дописывается в endObject()/endArray().
+class MsgPackWriter : public PayloadWriter {
+public:
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(std::string_view name) override;
+
+    const std::string& buffer() const { return buffer_; }
+    std::string release() { return std::move(buffer_); }
+
+protected:
+    void writeNull() override;
+    void writeBool(bool v) override;
+    void writeInt(int64_t v) override;
+    void writeString(std::string_view v) override;
+
+private:
+    struct Container {
+        size_t offset;
+        uint32_t count;
+        bool isMap;
+    };
+
+    void beginContainer(bool isMap);
+    void endContainer();
+    void countValue();
+    void putBigEndian(uint64_t v, int bytes);
+
+    std::string buffer_;
+    std::vector<Container> stack_;
+};
+
+// Разбирает тело запроса: MessagePack map со скалярными значениями.
+// Значения приводятся к строке так же, как Json::Value::asString().
+bool decodeMsgPackFields(std::string_view data,
+                         std::unordered_map<std::string, std::string>& fields);
+
+} // namespace api::v1
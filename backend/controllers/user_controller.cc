@@ -1,4 +1,5 @@
 #include "user_controller.h"
+#include "plugins/replica_router.h"
 #include <jwt-cpp/jwt.h>
 #include <drogon/orm/DbClient.h>
 #include <drogon/drogon.h>
@@ -101,40 +102,77 @@ std::string JwtUtil::extractTokenFromHeader(const HttpRequestPtr& req) {
     return "";
 }
 
+int JwtUtil::extractUserId(const std::string& token) {
+    try {
+        auto decoded = jwt::decode(token);
+        jwt::verify()
+            .allow_algorithm(jwt::algorithm::hs256{JwtConfig::SECRET_KEY})
+            .verify(decoded);
+        return std::stoi(decoded.get_payload_claim("user_id").as_string());
+    } catch (const std::exception& e) {
+        LOG_DEBUG << "Failed to extract user_id from token: " << e.what();
+        return -1;
+    }
+}
+
+RequestBody::RequestBody(const HttpRequestPtr& req)
+    : isMsgPack_(isMsgPackContentType(req->getHeader("Content-Type"))),
+      valid_(false) {
+    if (isMsgPack_) {
+        valid_ = decodeMsgPackFields(std::string_view(req->body()), fields_);
+    } else {
+        json_ = req->getJsonObject();
+        valid_ = json_ != nullptr;
+    }
+}
+
+const char* RequestBody::invalidMessage() const {
+    return isMsgPack_ ? "Invalid MessagePack" : "Invalid JSON";
+}
+
+bool RequestBody::has(const std::string& key) const {
+    if (isMsgPack_) {
+        return fields_.count(key) > 0;
+    }
+    return json_->isMember(key);
+}
+
+std::string RequestBody::getString(const std::string& key) const {
+    if (isMsgPack_) {
+        auto it = fields_.find(key);
+        return it == fields_.end() ? std::string() : it->second;
+    }
+    return (*json_)[key].asString();
+}
+
 User::User() {
     LOG_DEBUG << "User controller initialized";
 }
 
 void User::registerUser(const HttpRequestPtr& req,
                        std::function<void(const HttpResponsePtr&)>&& callback) {
-    auto json = req->getJsonObject();
-    if (!json) {
-        auto resp = HttpResponse::newHttpJsonResponse(createErrorResponse("Invalid JSON"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    auto format = responseFormat(req);
+    RequestBody body(req);
+    if (!body.valid()) {
+        callback(createErrorResponse(format, k400BadRequest, body.invalidMessage()));
         return;
     }
-    if (!json->isMember("email") || !json->isMember("login") || !json->isMember("password")) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Missing required fields: email, login, password"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    if (!body.has("email") || !body.has("login") || !body.has("password")) {
+        callback(createErrorResponse(format, k400BadRequest,
+                                     "Missing required fields: email, login, password"));
         return;
     }
-    std::string email = (*json)["email"].asString();
-    std::string login = (*json)["login"].asString();
-    std::string password = (*json)["password"].asString();
-    std::string phone = json->isMember("phone") ? (*json)["phone"].asString() : "";
+    std::string email = body.getString("email");
+    std::string login = body.getString("login");
+    std::string password = body.getString("password");
+    std::string phone = body.has("phone") ? body.getString("phone") : "";
 
     auto dbClient = app().getDbClient();
     *dbClient << "SELECT * FROM register_user($1, $2, $3, $4, $5)"
         << email << login << password << phone << 3
-        >> [callback](const orm::Result& r) {
+        >> [callback, format](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("Registration failed"));
-                resp->setStatusCode(k500InternalServerError);
-                callback(resp);
+                callback(createErrorResponse(format, k500InternalServerError, "Registration failed"));
                 return;
             }
             bool success = r[0]["success"].as<bool>();
@@ -142,59 +180,48 @@ void User::registerUser(const HttpRequestPtr& req,
 
             if (success) {
                 int userId = r[0]["user_id"].as<int>();
-                Json::Value data;
-                data["user_id"] = userId;
-
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createSuccessResponse("User registered successfully", data));
-                resp->setStatusCode(k201Created);
-                callback(resp);
+                markUserWrite(userId);
+                callback(createSuccessResponse(format, k201Created, "User registered successfully",
+                    [userId](PayloadWriter& w) {
+                        w.beginObject();
+                        w.field("user_id", userId);
+                        w.endObject();
+                    }));
             } else {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse(message));
-                resp->setStatusCode(k400BadRequest);
-                callback(resp);
+                callback(createErrorResponse(format, k400BadRequest, message));
             }
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error: " + std::string(e.base().what())));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError,
+                                         "Database error: " + std::string(e.base().what())));
         };
 }
 
 void User::login(const HttpRequestPtr& req,
                 std::function<void(const HttpResponsePtr&)>&& callback) {
-    auto json = req->getJsonObject();
-    if (!json) {
-        auto resp = HttpResponse::newHttpJsonResponse(createErrorResponse("Invalid JSON"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    auto format = responseFormat(req);
+    RequestBody body(req);
+    if (!body.valid()) {
+        callback(createErrorResponse(format, k400BadRequest, body.invalidMessage()));
         return;
     }
-    if (!json->isMember("login") || !json->isMember("password")) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Missing required fields: login, password"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    if (!body.has("login") || !body.has("password")) {
+        callback(createErrorResponse(format, k400BadRequest,
+                                     "Missing required fields: login, password"));
         return;
     }
-    std::string login = (*json)["login"].asString();
-    std::string password = (*json)["password"].asString();
+    std::string login = body.getString("login");
+    std::string password = body.getString("password");
     std::string ipAddress = req->peerAddr().toIp();
     std::string userAgent = req->getHeader("User-Agent");
 
     auto dbClient = app().getDbClient();
     *dbClient << "SELECT * FROM authenticate_user($1, $2, $3, $4)"
         << login << password << ipAddress << userAgent
-        >> [callback, ipAddress, userAgent](const orm::Result& r) {
+        >> [callback, format, ipAddress, userAgent](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("Authentication failed"));
-                resp->setStatusCode(k401Unauthorized);
-                callback(resp);
+                callback(createErrorResponse(format, k401Unauthorized, "Authentication failed"));
                 return;
             }
             bool success = r[0]["success"].as<bool>();
@@ -205,76 +232,62 @@ void User::login(const HttpRequestPtr& req,
                 std::string email = r[0]["email"].as<std::string>();
                 std::string loginData = r[0]["login"].as<std::string>();
                 std::string roleName = r[0]["role_name"].as<std::string>();
+                // authenticate_user создаёт сессию
+                markUserWrite(userId);
 
                 // Генерируем токены
                 std::string accessToken = JwtUtil::generateAccessToken(userId, email, loginData, roleName);
                 std::string refreshToken = JwtUtil::generateRefreshToken(userId);
 
                 if (accessToken.empty() || refreshToken.empty()) {
-                    auto resp = HttpResponse::newHttpJsonResponse(
-                        createErrorResponse("Failed to generate tokens"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
+                    callback(createErrorResponse(format, k500InternalServerError,
+                                                 "Failed to generate tokens"));
                     return;
                 }
 
-                Json::Value data;
-                data["user_id"] = userId;
-                data["email"] = email;
-                data["login"] = loginData;
-                data["role"] = roleName;
-                data["access_token"] = accessToken;
-                data["refresh_token"] = refreshToken;
-
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createSuccessResponse("Login successful", data));
-                resp->setStatusCode(k200OK);
-                callback(resp);
+                callback(createSuccessResponse(format, k200OK, "Login successful",
+                    [&](PayloadWriter& w) {
+                        w.beginObject();
+                        w.field("user_id", userId);
+                        w.field("email", email);
+                        w.field("login", loginData);
+                        w.field("role", roleName);
+                        w.field("access_token", accessToken);
+                        w.field("refresh_token", refreshToken);
+                        w.endObject();
+                    }));
             } else {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse(message));
-                resp->setStatusCode(k401Unauthorized);
-                callback(resp);
+                callback(createErrorResponse(format, k401Unauthorized, message));
             }
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
 void User::refreshToken(const HttpRequestPtr& req,
                        std::function<void(const HttpResponsePtr&)>&& callback) {
-    auto json = req->getJsonObject();
-    if (!json) {
-        auto resp = HttpResponse::newHttpJsonResponse(createErrorResponse("Invalid JSON"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    auto format = responseFormat(req);
+    RequestBody body(req);
+    if (!body.valid()) {
+        callback(createErrorResponse(format, k400BadRequest, body.invalidMessage()));
         return;
     }
-    if (!json->isMember("refresh_token")) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Missing refresh_token"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    if (!body.has("refresh_token")) {
+        callback(createErrorResponse(format, k400BadRequest, "Missing refresh_token"));
         return;
     }
-    std::string refreshToken = (*json)["refresh_token"].asString();
+    std::string refreshToken = body.getString("refresh_token");
     std::string ipAddress = req->peerAddr().toIp();
     std::string userAgent = req->getHeader("User-Agent");
 
     auto dbClient = app().getDbClient();
     *dbClient << "SELECT * FROM refresh_session($1, $2, $3)"
         << refreshToken << ipAddress << userAgent
-        >> [callback](const orm::Result& r) {
+        >> [callback, format, refreshToken](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("Token refresh failed"));
-                resp->setStatusCode(k401Unauthorized);
-                callback(resp);
+                callback(createErrorResponse(format, k401Unauthorized, "Token refresh failed"));
                 return;
             }
             bool success = r[0]["success"].as<bool>();
@@ -283,231 +296,191 @@ void User::refreshToken(const HttpRequestPtr& req,
             if (success) {
                 std::string newAccessToken = r[0]["new_access_token"].as<std::string>();
                 std::string newRefreshToken = r[0]["new_refresh_token"].as<std::string>();
-
-                Json::Value data;
-                data["access_token"] = newAccessToken;
-                data["refresh_token"] = newRefreshToken;
-
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createSuccessResponse("Tokens refreshed", data));
-                resp->setStatusCode(k200OK);
-                callback(resp);
+                // refresh_session может вернуть user_id; иначе берём его из
+                // присланного токена, если это наш JWT
+                int userId = -1;
+                for (size_t i = 0; i < r.columns(); ++i) {
+                    if (std::string(r.columnName(i)) == "user_id" && !r[0][i].isNull()) {
+                        userId = r[0][i].as<int>();
+                        break;
+                    }
+                }
+                if (userId < 0) {
+                    userId = JwtUtil::extractUserId(refreshToken);
+                }
+                if (userId < 0) {
+                    LOG_WARN << "refresh_session did not return user_id and refresh token "
+                                "carries none, read-your-writes not applied";
+                }
+                markUserWrite(userId);
+
+                callback(createSuccessResponse(format, k200OK, "Tokens refreshed",
+                    [&](PayloadWriter& w) {
+                        w.beginObject();
+                        w.field("access_token", newAccessToken);
+                        w.field("refresh_token", newRefreshToken);
+                        w.endObject();
+                    }));
             } else {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse(message));
-                resp->setStatusCode(k401Unauthorized);
-                callback(resp);
+                callback(createErrorResponse(format, k401Unauthorized, message));
             }
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
 void User::getUserInfo(const HttpRequestPtr& req,
                       std::function<void(const HttpResponsePtr&)>&& callback,
                       int id) {
+    auto format = responseFormat(req);
     auto authResult = authenticateRequest(req);
     if (!authResult.success) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse(authResult.message));
-        resp->setStatusCode(k401Unauthorized);
-        callback(resp);
+        callback(createErrorResponse(format, k401Unauthorized, authResult.message));
         return;
     }
     if (authResult.userId != id && authResult.role != "admin") {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Access denied"));
-        resp->setStatusCode(k403Forbidden);
-        callback(resp);
+        callback(createErrorResponse(format, k403Forbidden, "Access denied"));
         return;
     }
-    auto dbClient = app().getDbClient();
+    auto dbClient = readDbClient(id);
     *dbClient << "SELECT * FROM get_user_info($1)"
         << id
-        >> [callback](const orm::Result& r) {
+        >> [callback, format](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
+                callback(createErrorResponse(format, k404NotFound, "User not found"));
                 return;
             }
-            Json::Value data;
-            data["user_id"] = r[0]["user_id"].as<int>();
-            data["email"] = r[0]["email"].as<std::string>();
-            data["login"] = r[0]["login"].as<std::string>();
-            data["phone"] = r[0]["phone"].as<std::string>();
-            data["is_confirmed"] = r[0]["is_confirmed"].as<bool>();
-            data["is_profile_active"] = r[0]["is_profile_active"].as<bool>();
-            data["role_name"] = r[0]["role_name"].as<std::string>();
-
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createSuccessResponse("User info retrieved", data));
-            resp->setStatusCode(k200OK);
-            callback(resp);
+            callback(createSuccessResponse(format, k200OK, "User info retrieved",
+                [&r](PayloadWriter& w) {
+                    w.beginObject();
+                    w.field("user_id", r[0]["user_id"].as<int>());
+                    w.field("email", r[0]["email"].as<std::string>());
+                    w.field("login", r[0]["login"].as<std::string>());
+                    w.field("phone", r[0]["phone"].as<std::string>());
+                    w.field("is_confirmed", r[0]["is_confirmed"].as<bool>());
+                    w.field("is_profile_active", r[0]["is_profile_active"].as<bool>());
+                    w.field("role_name", r[0]["role_name"].as<std::string>());
+                    w.endObject();
+                }));
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
 void User::logout(const HttpRequestPtr& req,
                  std::function<void(const HttpResponsePtr&)>&& callback) {
+    auto format = responseFormat(req);
     auto authResult = authenticateRequest(req);
     if (!authResult.success) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse(authResult.message));
-        resp->setStatusCode(k401Unauthorized);
-        callback(resp);
+        callback(createErrorResponse(format, k401Unauthorized, authResult.message));
         return;
     }
     std::string token = JwtUtil::extractTokenFromHeader(req);
+    int userId = authResult.userId;
     auto dbClient = app().getDbClient();
     *dbClient << "SELECT * FROM logout_session($1)"
         << token
-        >> [callback](const orm::Result& r) {
+        >> [callback, format, userId](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("Logout failed"));
-                resp->setStatusCode(k500InternalServerError);
-                callback(resp);
+                callback(createErrorResponse(format, k500InternalServerError, "Logout failed"));
                 return;
             }
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createSuccessResponse("Logout successful"));
-            resp->setStatusCode(k200OK);
-            callback(resp);
+            markUserWrite(userId);
+            callback(createSuccessResponse(format, k200OK, "Logout successful"));
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
 void User::changePassword(const HttpRequestPtr& req,
                          std::function<void(const HttpResponsePtr&)>&& callback,
                          int id) {
+    auto format = responseFormat(req);
     auto authResult = authenticateRequest(req);
     if (!authResult.success) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse(authResult.message));
-        resp->setStatusCode(k401Unauthorized);
-        callback(resp);
+        callback(createErrorResponse(format, k401Unauthorized, authResult.message));
         return;
     }
     if (authResult.userId != id && authResult.role != "admin") {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Access denied"));
-        resp->setStatusCode(k403Forbidden);
-        callback(resp);
+        callback(createErrorResponse(format, k403Forbidden, "Access denied"));
         return;
     }
-    auto json = req->getJsonObject();
-    if (!json) {
-        auto resp = HttpResponse::newHttpJsonResponse(createErrorResponse("Invalid JSON"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    RequestBody body(req);
+    if (!body.valid()) {
+        callback(createErrorResponse(format, k400BadRequest, body.invalidMessage()));
         return;
     }
-    if (!json->isMember("old_password") || !json->isMember("new_password")) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Missing required fields"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
+    if (!body.has("old_password") || !body.has("new_password")) {
+        callback(createErrorResponse(format, k400BadRequest, "Missing required fields"));
         return;
     }
-    std::string oldPassword = (*json)["old_password"].asString();
-    std::string newPassword = (*json)["new_password"].asString();
+    std::string oldPassword = body.getString("old_password");
+    std::string newPassword = body.getString("new_password");
 
     auto dbClient = app().getDbClient();
     *dbClient << "SELECT * FROM change_password($1, $2, $3)"
         << id << oldPassword << newPassword
-        >> [callback](const orm::Result& r) {
+        >> [callback, format, id](const orm::Result& r) {
             if (r.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse("Change password failed"));
-                resp->setStatusCode(k500InternalServerError);
-                callback(resp);
+                callback(createErrorResponse(format, k500InternalServerError, "Change password failed"));
                 return;
             }
             bool success = r[0]["success"].as<bool>();
             std::string message = r[0]["message"].as<std::string>();
             if (success) {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createSuccessResponse(message));
-                resp->setStatusCode(k200OK);
-                callback(resp);
+                markUserWrite(id);
+                callback(createSuccessResponse(format, k200OK, message));
             } else {
-                auto resp = HttpResponse::newHttpJsonResponse(
-                    createErrorResponse(message));
-                resp->setStatusCode(k400BadRequest);
-                callback(resp);
+                callback(createErrorResponse(format, k400BadRequest, message));
             }
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
 void User::getActiveSessions(const HttpRequestPtr& req,
                             std::function<void(const HttpResponsePtr&)>&& callback,
                             int id) {
+    auto format = responseFormat(req);
     auto authResult = authenticateRequest(req);
     if (!authResult.success) {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse(authResult.message));
-        resp->setStatusCode(k401Unauthorized);
-        callback(resp);
+        callback(createErrorResponse(format, k401Unauthorized, authResult.message));
         return;
     }
     if (authResult.userId != id && authResult.role != "admin") {
-        auto resp = HttpResponse::newHttpJsonResponse(
-            createErrorResponse("Access denied"));
-        resp->setStatusCode(k403Forbidden);
-        callback(resp);
+        callback(createErrorResponse(format, k403Forbidden, "Access denied"));
         return;
     }
-    auto dbClient = app().getDbClient();
+    auto dbClient = readDbClient(id);
     *dbClient << "SELECT * FROM get_user_sessions($1)"
         << id
-        >> [callback](const orm::Result& r) {
-            Json::Value sessionsArray(Json::arrayValue);
-            for (auto row : r) {
-                Json::Value session;
-                session["session_id"] = row["session_id"].as<int>();
-                session["ip_address"] = row["ip_address"].as<std::string>();
-                session["user_agent"] = row["user_agent"].as<std::string>();
-                session["created_at"] = row["created_at"].as<std::string>();
-                session["last_activity"] = row["last_activity"].as<std::string>();
-                sessionsArray.append(session);
-            }
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createSuccessResponse("Active sessions retrieved", sessionsArray));
-            resp->setStatusCode(k200OK);
-            callback(resp);
+        >> [callback, format](const orm::Result& r) {
+            callback(createSuccessResponse(format, k200OK, "Active sessions retrieved",
+                [&r](PayloadWriter& w) {
+                    w.beginArray();
+                    for (auto row : r) {
+                        w.beginObject();
+                        w.field("session_id", row["session_id"].as<int>());
+                        w.field("ip_address", row["ip_address"].as<std::string>());
+                        w.field("user_agent", row["user_agent"].as<std::string>());
+                        w.field("created_at", row["created_at"].as<std::string>());
+                        w.field("last_activity", row["last_activity"].as<std::string>());
+                        w.endObject();
+                    }
+                    w.endArray();
+                }));
         }
-        >> [callback](const orm::DrogonDbException& e) {
+        >> [callback, format](const orm::DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                createErrorResponse("Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
+            callback(createErrorResponse(format, k500InternalServerError, "Database error"));
         };
 }
 
@@ -532,19 +505,76 @@ bool User::hasRole(const std::string& userRole, const std::string& requiredRole)
     return userRole == requiredRole || userRole == "admin";
 }
 
-Json::Value User::createSuccessResponse(const std::string& message, 
-                                        const Json::Value& data) {
-    Json::Value response;
-    response["success"] = true;
-    response["message"] = message;
-    response["data"] = data;
-    return response;
+// ReplicaRouter опционален. getPlugin<T>() пишет ошибку в лог, если плагина
+// нет, поэтому ищем его один раз по имени.
+static ReplicaRouter* replicaRouter() {
+    static auto* router = dynamic_cast<ReplicaRouter*>(
+        app().getPlugin(ReplicaRouter::classTypeName()));
+    return router;
+}
+
+orm::DbClientPtr User::readDbClient(int userId) {
+    auto router = replicaRouter();
+    return router ? router->readClientFor(userId) : app().getDbClient();
+}
+
+void User::markUserWrite(int userId) {
+    auto router = replicaRouter();
+    if (router) {
+        router->markWrite(userId);
+    }
+}
+
+PayloadFormat User::responseFormat(const HttpRequestPtr& req) {
+    return negotiatePayloadFormat(req->getHeader("Accept"), req->getHeader("Content-Type"));
+}
+
+HttpResponsePtr User::createSuccessResponse(PayloadFormat format, HttpStatusCode status,
+                                            const std::string& message,
+                                            const DataWriter& data) {
+    return createResponse(format, status, true, message, data);
 }
 
-Json::Value User::createErrorResponse(const std::string& message) {
-    Json::Value response;
-    response["success"] = false;
-    response["message"] = message;
-    response["data"] = Json::Value();
-    return response;
+HttpResponsePtr User::createErrorResponse(PayloadFormat format, HttpStatusCode status,
+                                          const std::string& message) {
+    return createResponse(format, status, false, message, nullptr);
+}
+
+HttpResponsePtr User::createResponse(PayloadFormat format, HttpStatusCode status,
+                                     bool success, const std::string& message,
+                                     const DataWriter& data) {
+    HttpResponsePtr resp;
+    if (format == PayloadFormat::MsgPack) {
+        // Кодируем сразу в MessagePack, без промежуточного Json::Value
+        MsgPackWriter writer;
+        writer.beginObject();
+        writer.field("success", success);
+        writer.field("message", message);
+        writer.key("data");
+        if (data) {
+            data(writer);
+        } else {
+            writer.value(nullptr);
+        }
+        writer.endObject();
+
+        resp = HttpResponse::newHttpResponse();
+        resp->setContentTypeString(kMsgPackContentType);
+        resp->setBody(writer.release());
+    } else {
+        Json::Value response;
+        response["success"] = success;
+        response["message"] = message;
+        response["data"] = Json::Value();
+        if (data) {
+            JsonValueWriter writer;
+            data(writer);
+            response["data"] = std::move(writer.root());
+        }
+        resp = HttpResponse::newHttpJsonResponse(response);
+    }
+    resp->setStatusCode(status);
+    // Без Accept формат ответа выбирается по Content-Type запроса
+    resp->addHeader("Vary", "Accept, Content-Type");
+    return resp;
 }
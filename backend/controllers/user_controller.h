@@ -5,8 +5,11 @@
 #include <drogon/HttpController.h>
 #include <drogon/orm/DbClient.h>
 #include <json/json.h>
+#include <functional>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include "api_payload.h"
 
 using namespace drogon;
 
@@ -38,10 +41,32 @@ public:
     
     static std::string extractTokenFromHeader(const HttpRequestPtr& req);
 
+    // user_id из токена, подписанного нашим ключом; -1, если токен чужой,
+    // просрочен или без user_id
+    static int extractUserId(const std::string& token);
+
 private:
     JwtUtil() = default;
 };
 
+// Тело запроса в JSON или MessagePack (по Content-Type) с одинаковыми полями
+class RequestBody {
+public:
+    explicit RequestBody(const HttpRequestPtr& req);
+
+    bool valid() const { return valid_; }
+    const char* invalidMessage() const;
+
+    bool has(const std::string& key) const;
+    std::string getString(const std::string& key) const;
+
+private:
+    bool isMsgPack_;
+    bool valid_;
+    std::shared_ptr<Json::Value> json_;
+    std::unordered_map<std::string, std::string> fields_;
+};
+
 class User : public drogon::HttpController<User> {
 public:
     METHOD_LIST_BEGIN
@@ -90,9 +115,20 @@ private:
 
     AuthResult authenticateRequest(const HttpRequestPtr& req);
     bool hasRole(const std::string& userRole, const std::string& requiredRole);
-    static Json::Value createSuccessResponse(const std::string& message, 
-                                            const Json::Value& data = Json::Value());
-    static Json::Value createErrorResponse(const std::string& message);
+    static orm::DbClientPtr readDbClient(int userId);
+    static void markUserWrite(int userId);
+
+    using DataWriter = std::function<void(PayloadWriter&)>;
+
+    static PayloadFormat responseFormat(const HttpRequestPtr& req);
+    static HttpResponsePtr createSuccessResponse(PayloadFormat format, HttpStatusCode status,
+                                                 const std::string& message,
+                                                 const DataWriter& data = nullptr);
+    static HttpResponsePtr createErrorResponse(PayloadFormat format, HttpStatusCode status,
+                                               const std::string& message);
+    static HttpResponsePtr createResponse(PayloadFormat format, HttpStatusCode status,
+                                          bool success, const std::string& message,
+                                          const DataWriter& data);
 };
 
 } // namespace api::v1
@@ -0,0 +1,97 @@
+#include "replica_router.h"
+#include <drogon/drogon.h>
+
+using namespace drogon;
+
+void ReplicaRouter::initAndStart(const Json::Value& config) {
+    replicaClientName_ = config.get("replica_client", replicaClientName_).asString();
+    maxLagSeconds_ = config.get("max_lag_seconds", maxLagSeconds_).asDouble();
+    lagCheckInterval_ = config.get("lag_check_interval", lagCheckInterval_).asDouble();
+    double window = config.get("read_your_writes_window", 10.0).asDouble();
+    double minWindow = ReplicaRouting::minReadYourWritesWindow(maxLagSeconds_, lagCheckInterval_);
+    if (window < minWindow) {
+        LOG_WARN << "read_your_writes_window=" << window << "s is shorter than max_lag_seconds + "
+                 << "lag_check_interval, using " << minWindow << "s";
+        window = minWindow;
+    }
+    routing_.setReadYourWritesWindow(std::chrono::milliseconds(static_cast<long long>(window * 1000)));
+
+    // db_clients создаются при старте приложения, поэтому реплику
+    // запрашиваем уже из таймера, а не здесь.
+    lagTimerId_ = app().getLoop()->runEvery(lagCheckInterval_, [this]() { checkLag(); });
+
+    LOG_INFO << "ReplicaRouter started: replica_client=" << replicaClientName_
+             << ", max_lag_seconds=" << maxLagSeconds_;
+}
+
+void ReplicaRouter::shutdown() {
+    app().getLoop()->invalidateTimer(lagTimerId_);
+    routing_.setReplicaFresh(false);
+}
+
+orm::DbClientPtr ReplicaRouter::readClientFor(int userId) {
+    return routing_.useReplica(userId) ? replica_ : app().getDbClient();
+}
+
+void ReplicaRouter::markWrite(int userId) {
+    routing_.markWrite(userId);
+}
+
+void ReplicaRouter::checkLag() {
+    routing_.pruneExpired();
+
+    if (!replica_) {
+        // Клиент replica_client обязан быть в db_clients. В debug-сборке drogon
+        // падает на assert, в release возвращает пустой указатель.
+        replica_ = app().getDbClient(replicaClientName_);
+        if (!replica_) {
+            LOG_ERROR << "Replica db client '" << replicaClientName_
+                      << "' is not declared in db_clients, ReplicaRouter disabled";
+            app().getLoop()->invalidateTimer(lagTimerId_);
+            return;
+        }
+    }
+
+    // Не накапливаем проверки, если реплика не отвечает. Зависшую проверку
+    // завершит timeout клиента реплики, и флаг сбросится в обработчике ошибки.
+    if (checkInFlight_.exchange(true)) {
+        if (routing_.setReplicaFresh(false)) {
+            LOG_WARN << "Replica lag check is still running, reads go to primary";
+        }
+        return;
+    }
+
+    // Если WAL receiver стримит и всё полученное уже применено, реплика
+    // догнала primary, даже когда на primary давно не было транзакций.
+    // Без живого стрима receive LSN замирает, и отставание неизвестно.
+    *replica_ << "SELECT CASE "
+                 "WHEN NOT pg_is_in_recovery() THEN NULL "
+                 "WHEN NOT EXISTS (SELECT 1 FROM pg_stat_wal_receiver "
+                 "WHERE status = 'streaming') THEN NULL "
+                 "WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+                 "ELSE EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) "
+                 "END::float8 AS lag_seconds"
+        >> [this](const orm::Result& r) {
+            checkInFlight_ = false;
+            if (r.empty() || r[0]["lag_seconds"].isNull()) {
+                if (routing_.setReplicaFresh(false)) {
+                    LOG_WARN << "Replica is not streaming or lag is unknown, reads go to primary";
+                }
+                return;
+            }
+            double lag = r[0]["lag_seconds"].as<double>();
+            bool fresh = lag <= maxLagSeconds_;
+            if (routing_.setReplicaFresh(fresh) != fresh) {
+                LOG_INFO << "Replica lag " << lag << "s, reads go to "
+                         << (fresh ? "replica" : "primary");
+            }
+        }
+        >> [this](const orm::DrogonDbException& e) {
+            checkInFlight_ = false;
+            if (routing_.setReplicaFresh(false)) {
+                LOG_ERROR << "Replica lag check failed, reads go to primary: " << e.base().what();
+            } else {
+                LOG_DEBUG << "Replica lag check failed: " << e.base().what();
+            }
+        };
+}
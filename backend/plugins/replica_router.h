@@ -0,0 +1,52 @@
+// replica_router.h
+
+#pragma once
+
+#include <drogon/plugins/Plugin.h>
+#include <drogon/orm/DbClient.h>
+#include <trantor/net/EventLoop.h>
+#include <json/json.h>
+#include <atomic>
+#include <string>
+#include "replica_routing.h"
+
+// Направляет чтения на реплику, пока её отставание в пределах порога.
+// Плагин опционален: без него все чтения идут на primary.
+// Конфигурация (раздел "plugins" в config.json):
+//   replica_client          — имя db_client реплики ("replica"), должен
+//                             быть объявлен в db_clients
+//   max_lag_seconds         — порог отставания, выше которого читаем с primary
+//   lag_check_interval      — период опроса реплики, в секундах; timeout
+//                             db_client реплики не должен быть больше него
+//   read_your_writes_window — сколько секунд после записи пользователя
+//                             его чтения идут на primary; не меньше
+//                             max_lag_seconds + lag_check_interval, иначе
+//                             поднимается до этого минимума
+class ReplicaRouter : public drogon::Plugin<ReplicaRouter> {
+public:
+    ReplicaRouter() = default;
+
+    void initAndStart(const Json::Value& config) override;
+    void shutdown() override;
+
+    // Клиент для чтения данных пользователя: реплика, если она свежая и
+    // пользователь недавно ничего не писал, иначе primary.
+    drogon::orm::DbClientPtr readClientFor(int userId);
+
+    // Отмечает запись пользователя в primary (read-your-writes).
+    void markWrite(int userId);
+
+private:
+    void checkLag();
+
+    std::string replicaClientName_{"replica"};
+    double maxLagSeconds_{5.0};
+    double lagCheckInterval_{1.0};
+
+    // Заполняется один раз из таймера, читается только когда реплика свежая
+    drogon::orm::DbClientPtr replica_;
+
+    ReplicaRouting routing_;
+    std::atomic<bool> checkInFlight_{false};
+    trantor::TimerId lagTimerId_{0};
+};
@@ -0,0 +1,39 @@
+#include "replica_routing.h"
+
+void ReplicaRouting::setReadYourWritesWindow(std::chrono::milliseconds window) {
+    std::lock_guard<std::mutex> lock(writesMutex_);
+    readYourWritesWindow_ = window;
+}
+
+void ReplicaRouting::markWrite(int userId, Clock::time_point now) {
+    if (userId < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(writesMutex_);
+    lastWrites_[userId] = now;
+}
+
+bool ReplicaRouting::useReplica(int userId, Clock::time_point now) {
+    if (!replicaFresh_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(writesMutex_);
+    auto it = lastWrites_.find(userId);
+    return it == lastWrites_.end() || now - it->second >= readYourWritesWindow_;
+}
+
+void ReplicaRouting::pruneExpired(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(writesMutex_);
+    for (auto it = lastWrites_.begin(); it != lastWrites_.end();) {
+        if (now - it->second >= readYourWritesWindow_) {
+            it = lastWrites_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t ReplicaRouting::trackedWrites() {
+    std::lock_guard<std::mutex> lock(writesMutex_);
+    return lastWrites_.size();
+}
@@ -0,0 +1,53 @@
+// replica_routing.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+// Правила выбора между репликой и primary для ReplicaRouter, без
+// зависимости от drogon. Время передаётся явно, чтобы правила можно
+// было проверять в тестах без ожидания.
+class ReplicaRouting {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ReplicaRouting(std::chrono::milliseconds readYourWritesWindow = std::chrono::seconds(10))
+        : readYourWritesWindow_(readYourWritesWindow) {}
+
+    void setReadYourWritesWindow(std::chrono::milliseconds window);
+
+    // Реплика считается свежей с отставанием до maxLagSeconds и остаётся
+    // такой до следующей проверки. Более короткое окно не гарантирует
+    // read-your-writes, поэтому оно поднимается до этой суммы.
+    static double minReadYourWritesWindow(double maxLagSeconds, double lagCheckInterval) {
+        return maxLagSeconds + lagCheckInterval;
+    }
+
+    // Возвращает предыдущее состояние, чтобы логировать только переключения.
+    // Пока первая проверка не прошла, реплика считается непригодной.
+    bool setReplicaFresh(bool fresh) { return replicaFresh_.exchange(fresh); }
+    bool replicaFresh() const { return replicaFresh_; }
+
+    // Отмечает запись пользователя; userId < 0 (id не удалось извлечь) игнорируется.
+    void markWrite(int userId, Clock::time_point now = Clock::now());
+
+    // Читать ли данные пользователя с реплики: она свежая и пользователь
+    // ничего не писал в пределах окна read-your-writes.
+    bool useReplica(int userId, Clock::time_point now = Clock::now());
+
+    // Удаляет отметки записей старше окна, чтобы карта не росла бесконечно.
+    void pruneExpired(Clock::time_point now = Clock::now());
+
+    size_t trackedWrites();
+
+private:
+    std::atomic<bool> replicaFresh_{false};
+
+    std::mutex writesMutex_;
+    std::chrono::milliseconds readYourWritesWindow_;
+    std::unordered_map<int, Clock::time_point> lastWrites_;
+};
@@ -0,0 +1,359 @@
+// payload_bench.cc
+//
+// Сравнение JSON (jsoncpp, как в newHttpJsonResponse/getJsonObject) и
+// MessagePack для типичных payload'ов /api/v1: размер и время encode/decode.
+// Decode меряется с обеих сторон: тело запроса на сервере и ответ
+// (success/message/data) у вызывающего сервиса.
+// Запуск: ./payload_bench [iterations]
+
+#include "controllers/api_payload.h"
+#include <json/json.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace api::v1;
+
+namespace {
+
+using DataWriter = std::function<void(PayloadWriter&)>;
+
+const std::string kAccessToken(220, 'a');
+const std::string kRefreshToken(180, 'r');
+
+void writeEnvelope(PayloadWriter& w, const std::string& message, const DataWriter& data) {
+    w.beginObject();
+    w.field("success", true);
+    w.field("message", message);
+    w.key("data");
+    data(w);
+    w.endObject();
+}
+
+void writeLoginData(PayloadWriter& w) {
+    w.beginObject();
+    w.field("user_id", 12345);
+    w.field("email", "user@example.com");
+    w.field("login", "user");
+    w.field("role", "user");
+    w.field("access_token", kAccessToken);
+    w.field("refresh_token", kRefreshToken);
+    w.endObject();
+}
+
+void writeUserInfoData(PayloadWriter& w) {
+    w.beginObject();
+    w.field("user_id", 12345);
+    w.field("email", "user@example.com");
+    w.field("login", "user");
+    w.field("phone", "+79990000000");
+    w.field("is_confirmed", true);
+    w.field("is_profile_active", true);
+    w.field("role_name", "user");
+    w.endObject();
+}
+
+void writeSessionsData(PayloadWriter& w) {
+    w.beginArray();
+    for (int i = 0; i < 10; ++i) {
+        w.beginObject();
+        w.field("session_id", 1000 + i);
+        w.field("ip_address", "192.168.0.10");
+        w.field("user_agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36");
+        w.field("created_at", "2025-01-01 12:00:00");
+        w.field("last_activity", "2025-01-01 12:30:00");
+        w.endObject();
+    }
+    w.endArray();
+}
+
+void writeLoginRequest(PayloadWriter& w) {
+    w.beginObject();
+    w.field("login", "user");
+    w.field("password", "correct horse battery staple");
+    w.endObject();
+}
+
+void writeRefreshRequest(PayloadWriter& w) {
+    w.beginObject();
+    w.field("refresh_token", kRefreshToken);
+    w.endObject();
+}
+
+// Тот же writer, что использует drogon для newHttpJsonResponse
+std::string encodeJson(const Json::Value& value) {
+    static const auto writer = [] {
+        Json::StreamWriterBuilder builder;
+        builder["commentStyle"] = "None";
+        builder["indentation"] = "";
+        return std::unique_ptr<Json::StreamWriter>(builder.newStreamWriter());
+    }();
+    std::ostringstream out;
+    writer->write(value, &out);
+    return out.str();
+}
+
+// Полный разбор MessagePack-ответа в Json::Value, как его разбирал бы
+// вызывающий сервис на jsoncpp. Поддерживает типы, которые пишет MsgPackWriter.
+class MsgPackTreeReader {
+public:
+    explicit MsgPackTreeReader(std::string_view data) : data_(data) {}
+
+    bool read(Json::Value& out) {
+        return readValue(out) && pos_ == data_.size();
+    }
+
+private:
+    bool readBigEndian(int bytes, uint64_t& v) {
+        if (data_.size() - pos_ < static_cast<size_t>(bytes)) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < bytes; ++i) {
+            v = (v << 8) | static_cast<uint8_t>(data_[pos_++]);
+        }
+        return true;
+    }
+
+    bool readString(uint64_t n, Json::Value& out) {
+        if (data_.size() - pos_ < n) {
+            return false;
+        }
+        out = Json::Value(data_.data() + pos_, data_.data() + pos_ + n);
+        pos_ += n;
+        return true;
+    }
+
+    bool readMap(uint64_t n, Json::Value& out) {
+        out = Json::Value(Json::objectValue);
+        for (uint64_t i = 0; i < n; ++i) {
+            Json::Value key;
+            if (!readValue(key) || !key.isString() || !readValue(out[key.asString()])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readArray(uint64_t n, Json::Value& out) {
+        out = Json::Value(Json::arrayValue);
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!readValue(out.append(Json::Value()))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readValue(Json::Value& out) {
+        if (pos_ >= data_.size()) {
+            return false;
+        }
+        auto b = static_cast<uint8_t>(data_[pos_++]);
+        uint64_t u;
+        if (b <= 0x7f) {
+            out = static_cast<Json::Int64>(b);
+            return true;
+        }
+        if (b >= 0xe0) {
+            out = static_cast<Json::Int64>(static_cast<int8_t>(b));
+            return true;
+        }
+        if ((b & 0xf0) == 0x80) {
+            return readMap(b & 0x0f, out);
+        }
+        if ((b & 0xf0) == 0x90) {
+            return readArray(b & 0x0f, out);
+        }
+        if ((b & 0xe0) == 0xa0) {
+            return readString(b & 0x1f, out);
+        }
+        switch (b) {
+        case 0xc0:
+            out = Json::Value();
+            return true;
+        case 0xc2:
+            out = false;
+            return true;
+        case 0xc3:
+            out = true;
+            return true;
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (!readBigEndian(1 << (b - 0xcc), u)) {
+                return false;
+            }
+            // jsoncpp хранит такие числа как intValue, если они влезают в Int64
+            if (u <= static_cast<uint64_t>(INT64_MAX)) {
+                out = static_cast<Json::Int64>(u);
+            } else {
+                out = static_cast<Json::UInt64>(u);
+            }
+            return true;
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3: {
+            int bytes = 1 << (b - 0xd0);
+            if (!readBigEndian(bytes, u)) {
+                return false;
+            }
+            int shift = 64 - bytes * 8;
+            out = static_cast<Json::Int64>(shift ? static_cast<int64_t>(u << shift) >> shift
+                                                 : static_cast<int64_t>(u));
+            return true;
+        }
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            return readBigEndian(1 << (b - 0xd9), u) && readString(u, out);
+        case 0xdc:
+        case 0xdd:
+            return readBigEndian(b == 0xdc ? 2 : 4, u) && readArray(u, out);
+        case 0xde:
+        case 0xdf:
+            return readBigEndian(b == 0xde ? 2 : 4, u) && readMap(u, out);
+        default:
+            return false;
+        }
+    }
+
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+template <typename F>
+double nsPerOp(int iterations, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Защита от выбрасывания результата оптимизатором
+volatile size_t sink;
+
+void benchEncode(const char* name, const std::string& message, const DataWriter& data,
+                 int iterations) {
+    // JSON как раньше: Json::Value целиком, затем сериализация
+    auto jsonOnce = [&] {
+        JsonValueWriter w;
+        writeEnvelope(w, message, data);
+        return encodeJson(w.root());
+    };
+    auto msgpackOnce = [&] {
+        MsgPackWriter w;
+        writeEnvelope(w, message, data);
+        return w.release();
+    };
+
+    size_t jsonBytes = jsonOnce().size();
+    size_t msgpackBytes = msgpackOnce().size();
+    double jsonNs = nsPerOp(iterations, [&] { sink = jsonOnce().size(); });
+    double msgpackNs = nsPerOp(iterations, [&] { sink = msgpackOnce().size(); });
+
+    std::printf("%-22s %8zu %8zu %11.0f %11.0f %7.1fx\n", name, jsonBytes, msgpackBytes,
+                jsonNs, msgpackNs, jsonNs / msgpackNs);
+}
+
+void benchDecode(const char* name, const DataWriter& data, int iterations) {
+    JsonValueWriter jw;
+    data(jw);
+    std::string json = encodeJson(jw.root());
+    MsgPackWriter mw;
+    data(mw);
+    std::string msgpack = mw.release();
+
+    // getJsonObject в drogon разбирает тело через CharReader
+    std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    double jsonNs = nsPerOp(iterations, [&] {
+        Json::Value root;
+        std::string errs;
+        reader->parse(json.data(), json.data() + json.size(), &root, &errs);
+        sink = root.size();
+    });
+    double msgpackNs = nsPerOp(iterations, [&] {
+        std::unordered_map<std::string, std::string> fields;
+        decodeMsgPackFields(msgpack, fields);
+        sink = fields.size();
+    });
+
+    std::printf("%-22s %8zu %8zu %11.0f %11.0f %7.1fx\n", name, json.size(), msgpack.size(),
+                jsonNs, msgpackNs, jsonNs / msgpackNs);
+}
+
+// Вызывающий сервис разбирает ответ целиком в Json::Value в обоих случаях,
+// поэтому разница — только в стоимости разбора байтов.
+void benchDecodeResponse(const char* name, const std::string& message, const DataWriter& data,
+                         int iterations) {
+    JsonValueWriter jw;
+    writeEnvelope(jw, message, data);
+    std::string json = encodeJson(jw.root());
+    MsgPackWriter mw;
+    writeEnvelope(mw, message, data);
+    std::string msgpack = mw.release();
+
+    // Оба разбора должны дать одно и то же дерево
+    Json::Value fromMsgPack;
+    if (!MsgPackTreeReader(msgpack).read(fromMsgPack) || fromMsgPack != jw.root()) {
+        std::printf("%-22s MessagePack response does not round-trip\n", name);
+        return;
+    }
+
+    std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    double jsonNs = nsPerOp(iterations, [&] {
+        Json::Value root;
+        std::string errs;
+        reader->parse(json.data(), json.data() + json.size(), &root, &errs);
+        sink = root.size();
+    });
+    double msgpackNs = nsPerOp(iterations, [&] {
+        Json::Value root;
+        MsgPackTreeReader(msgpack).read(root);
+        sink = root.size();
+    });
+
+    std::printf("%-22s %8zu %8zu %11.0f %11.0f %7.1fx\n", name, json.size(), msgpack.size(),
+                jsonNs, msgpackNs, jsonNs / msgpackNs);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    std::printf("%-22s %8s %8s %11s %11s %8s\n", "payload", "json B", "mpack B",
+                "json ns/op", "mpack ns/op", "speedup");
+
+    std::printf("-- encode response --\n");
+    benchEncode("login", "Login successful", writeLoginData, iterations);
+    benchEncode("refreshToken", "Tokens refreshed", [](PayloadWriter& w) {
+        w.beginObject();
+        w.field("access_token", kAccessToken);
+        w.field("refresh_token", kRefreshToken);
+        w.endObject();
+    }, iterations);
+    benchEncode("getUserInfo", "User info retrieved", writeUserInfoData, iterations);
+    benchEncode("getActiveSessions(10)", "Active sessions retrieved", writeSessionsData,
+                iterations / 10);
+
+    std::printf("-- decode request --\n");
+    benchDecode("login", writeLoginRequest, iterations);
+    benchDecode("refreshToken", writeRefreshRequest, iterations);
+
+    std::printf("-- decode response (caller) --\n");
+    benchDecodeResponse("login", "Login successful", writeLoginData, iterations);
+    benchDecodeResponse("getUserInfo", "User info retrieved", writeUserInfoData, iterations);
+    benchDecodeResponse("getActiveSessions(10)", "Active sessions retrieved", writeSessionsData,
+                        iterations / 10);
+    return 0;
+}
@@ -1,12 +1,188 @@
 #define DROGON_TEST_MAIN
 #include <drogon/drogon_test.h>
 #include <drogon/drogon.h>
+#include "controllers/api_payload.h"
+#include "plugins/replica_routing.h"
+
+using namespace api::v1;
 
 DROGON_TEST(BasicTest)
 {
     // Add your tests here
 }
 
+DROGON_TEST(PayloadFormatNegotiation)
+{
+    CHECK(negotiatePayloadFormat("", "") == PayloadFormat::Json);
+    CHECK(negotiatePayloadFormat("", "application/msgpack") == PayloadFormat::MsgPack);
+    CHECK(negotiatePayloadFormat("application/msgpack", "application/json") == PayloadFormat::MsgPack);
+    CHECK(negotiatePayloadFormat("application/json, application/msgpack;q=0.5", "") == PayloadFormat::Json);
+    CHECK(negotiatePayloadFormat("*/*", "application/x-msgpack") == PayloadFormat::MsgPack);
+    CHECK(negotiatePayloadFormat("*/*", "") == PayloadFormat::Json);
+}
+
+DROGON_TEST(MsgPackWriterEncoding)
+{
+    MsgPackWriter w;
+    w.beginObject();
+    w.field("success", true);
+    w.field("id", 300);
+    w.field("data", nullptr);
+    w.endObject();
+    CHECK(w.buffer() == std::string("\x83\xa7success\xc3\xa2id\xcd\x01\x2c\xa4" "data\xc0", 22));
+
+    // Больше 15 элементов — заголовок array16
+    MsgPackWriter big;
+    big.beginArray();
+    for (int i = 0; i < 16; ++i) {
+        big.value(i);
+    }
+    big.endArray();
+    REQUIRE(big.buffer().size() == 19);
+    CHECK(static_cast<unsigned char>(big.buffer()[0]) == 0xdc);
+    CHECK(big.buffer()[2] == 16);
+}
+
+DROGON_TEST(JsonValueWriterMatchesJsonValue)
+{
+    // Ответ login: вложенный объект в data, собранный как раньше вручную
+    Json::Value loginData;
+    loginData["user_id"] = 42;
+    loginData["email"] = "user@example.com";
+    loginData["access_token"] = "token";
+    Json::Value expectedLogin;
+    expectedLogin["success"] = true;
+    expectedLogin["message"] = "Login successful";
+    expectedLogin["data"] = loginData;
+
+    JsonValueWriter login;
+    login.beginObject();
+    login.field("success", true);
+    login.field("message", "Login successful");
+    login.key("data");
+    login.beginObject();
+    login.field("user_id", 42);
+    login.field("email", "user@example.com");
+    login.field("access_token", std::string("token"));
+    login.endObject();
+    login.endObject();
+    CHECK(login.root() == expectedLogin);
+
+    // getActiveSessions без строк: data должно остаться [], а не null
+    JsonValueWriter empty;
+    empty.beginArray();
+    empty.endArray();
+    CHECK(empty.root() == Json::Value(Json::arrayValue));
+    CHECK(empty.root().toStyledString() == Json::Value(Json::arrayValue).toStyledString());
+
+    Json::Value session;
+    session["session_id"] = 7;
+    session["is_active"] = false;
+    Json::Value expectedSessions(Json::arrayValue);
+    expectedSessions.append(session);
+    JsonValueWriter sessions;
+    sessions.beginArray();
+    sessions.beginObject();
+    sessions.field("session_id", 7);
+    sessions.field("is_active", false);
+    sessions.endObject();
+    sessions.endArray();
+    CHECK(sessions.root() == expectedSessions);
+
+    // int64 за пределами int и null
+    Json::Value expectedWide;
+    expectedWide["big"] = static_cast<Json::Int64>(5000000000LL);
+    expectedWide["negative"] = static_cast<Json::Int64>(-5000000000LL);
+    expectedWide["data"] = Json::Value();
+    JsonValueWriter wide;
+    wide.beginObject();
+    wide.field("big", static_cast<int64_t>(5000000000LL));
+    wide.field("negative", static_cast<int64_t>(-5000000000LL));
+    wide.field("data", nullptr);
+    wide.endObject();
+    CHECK(wide.root() == expectedWide);
+    CHECK(wide.root()["big"].asInt64() == 5000000000LL);
+}
+
+DROGON_TEST(MsgPackFieldsDecoding)
+{
+    MsgPackWriter w;
+    w.beginObject();
+    w.field("login", "user");
+    w.field("password", std::string(40, 'p'));
+    w.field("pin", -200);
+    w.field("remember", false);
+    w.endObject();
+
+    std::unordered_map<std::string, std::string> fields;
+    REQUIRE(decodeMsgPackFields(w.buffer(), fields));
+    CHECK(fields["login"] == "user");
+    CHECK(fields["password"] == std::string(40, 'p'));
+    CHECK(fields["pin"] == "-200");
+    CHECK(fields["remember"] == "false");
+
+    // Обрезанное тело и вложенные значения отклоняются
+    CHECK(!decodeMsgPackFields(w.buffer().substr(0, w.buffer().size() - 1), fields));
+    MsgPackWriter nested;
+    nested.beginObject();
+    nested.key("data");
+    nested.beginArray();
+    nested.endArray();
+    nested.endObject();
+    CHECK(!decodeMsgPackFields(nested.buffer(), fields));
+}
+
+DROGON_TEST(ReplicaRoutingFreshness)
+{
+    ReplicaRouting routing;
+    // До первой успешной проверки отставания читаем с primary
+    CHECK(!routing.useReplica(1));
+
+    CHECK(!routing.setReplicaFresh(true));
+    CHECK(routing.useReplica(1));
+
+    CHECK(routing.setReplicaFresh(false));
+    CHECK(!routing.useReplica(1));
+}
+
+DROGON_TEST(ReplicaRoutingReadYourWrites)
+{
+    using namespace std::chrono_literals;
+    ReplicaRouting routing(10s);
+    routing.setReplicaFresh(true);
+    auto t0 = ReplicaRouting::Clock::now();
+
+    routing.markWrite(7, t0);
+    CHECK(!routing.useReplica(7, t0 + 5s));
+    CHECK(routing.useReplica(8, t0 + 5s));
+    CHECK(routing.useReplica(7, t0 + 10s));
+
+    // -1 от JwtUtil::extractUserId не отслеживается
+    routing.markWrite(-1, t0);
+    CHECK(routing.trackedWrites() == 1);
+}
+
+DROGON_TEST(ReplicaRoutingPruneExpired)
+{
+    using namespace std::chrono_literals;
+    ReplicaRouting routing(10s);
+    auto t0 = ReplicaRouting::Clock::now();
+
+    routing.markWrite(1, t0);
+    routing.markWrite(2, t0 + 8s);
+    routing.pruneExpired(t0 + 10s);
+    CHECK(routing.trackedWrites() == 1);
+    routing.pruneExpired(t0 + 18s);
+    CHECK(routing.trackedWrites() == 0);
+}
+
+DROGON_TEST(ReplicaRoutingMinWindow)
+{
+    // Окно read-your-writes покрывает максимальное отставание и период проверки
+    CHECK(ReplicaRouting::minReadYourWritesWindow(5.0, 1.0) == 6.0);
+    CHECK(ReplicaRouting::minReadYourWritesWindow(0.0, 1.0) == 1.0);
+}
+
 int main(int argc, char** argv) 
 {
     using namespace drogon;